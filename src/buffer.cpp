@@ -1,27 +1,36 @@
 #include "buffer.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
-Buffer::Buffer(const std::string &file, std::function<void()> rcb, size_t chunk)
-    : filename(file), chunk_size(chunk), render_callback(rcb) {
-  std::ifstream file_stream(filename, std::ios::binary | std::ios::ate);
-  if (file_stream) {
-    file_size = file_stream.tellg(); // Get total file size
-  }
-  loadChunk(0); // Load initial chunk
+namespace {
+
+// How often a background scan republishes the growing size
+constexpr std::chrono::milliseconds kScanPublishInterval(100);
+
+} // namespace
+
+Buffer::Buffer(const std::string &file, std::function<void()> rcb, size_t chunk,
+               std::chrono::milliseconds poll)
+    : chunk_size(chunk), filename(file), render_callback(rcb),
+      poll_interval(poll), pipeline(file) {
+  publishChunk(0, chunk_size); // Load initial chunk
 
   last_write_time = std::filesystem::last_write_time(filename);
-  loadChunk(0);
 
-  // Launch the file-watcher thread
-  watcher_thread = std::thread([this] { watchFileChanges(); });
+  // Launch the loader thread, which also watches the file
+  loader_thread = std::thread([this] { loaderLoop(); });
 }
 
 Buffer::~Buffer() {
-  running = false;
-  if (watcher_thread.joinable())
-    watcher_thread.join();
+  {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    running = false;
+  }
+  request_signal.notify_one();
+  if (loader_thread.joinable())
+    loader_thread.join();
 }
 
 size_t Buffer::whichChunkAreWe(size_t position) {
@@ -29,38 +38,128 @@ size_t Buffer::whichChunkAreWe(size_t position) {
   return position / chunk_size;
 }
 
-void Buffer::loadChunk(size_t chunk) {
-  std::lock_guard<std::mutex> lock(buffer_mutex);
-  size_t offset = (chunk > 1) ? (chunk - 1) * chunk_size : 0;
+void Buffer::publishChunk(size_t chunk, size_t size) {
+  // Build the next version aside; readers keep the current one meanwhile
+  auto next = std::make_shared<BufferSnapshot>();
+  size_t offset = (chunk > 1) ? (chunk - 1) * size : 0;
+
+  // 🛠 Load THREE chunks: previous, current, next (for smooth transitions)
+  // Reads go through the transform pipeline, which only evaluates the pages
+  // covered by this window
+  size_t total_size = size * 3;
+  next->data.resize(total_size);
+  next->data.resize(pipeline.read(offset, next->data.data(), total_size));
+  next->chunk_offset = offset;
+  next->file_size = pipeline.size();
+  next->transforms = pipeline.describe();
+  next->scanning = scanning;
+  next->generation = generation;
+  next->version = ++version;
+
+  current_chunk = chunk;
+  loaded_chunk_size = size;
+  loaded_file_size = next->file_size;
+
+  std::atomic_store_explicit(&current,
+                             std::shared_ptr<const BufferSnapshot>(
+                                 std::move(next)),
+                             std::memory_order_release);
+}
 
-  std::ifstream file(filename, std::ios::binary);
-  if (file) {
-    file.seekg(offset);
+// Only posts the request; the loader publishes the chunk when it is ready
+// and the view draws the previous snapshot until then
+void Buffer::checkChunks(size_t new_position, bool force) {
+  {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    wanted_position = new_position;
+    reload_requested = reload_requested || force;
+  }
+  request_signal.notify_one();
+}
 
-    // 🛠 Load THREE chunks: previous, current, next (for smooth transitions)
-    size_t total_size = chunk_size * 3;
-    data.resize(total_size);
-    file.read(reinterpret_cast<char *>(data.data()), total_size);
-    data.resize(file.gcount()); // Resize to actual read size
-    chunk_offset = offset;
+bool Buffer::hasWork() {
+  if (!running || reload_requested || invalidate_requested ||
+      !pipeline_edits.empty() ||
+      chunk_size != loaded_chunk_size) {
+    return true;
   }
+  size_t last = loaded_file_size > 0 ? loaded_file_size - 1 : 0;
+  return std::min(wanted_position, last) / loaded_chunk_size != current_chunk;
 }
 
-void Buffer::checkChunks(size_t new_position, bool force) {
+void Buffer::loaderLoop() {
+  using clock = std::chrono::steady_clock;
+  auto next_poll = clock::now() + poll_interval;
+  auto last_publish = clock::now();
+
+  while (true) {
+    size_t position;
+    bool force;
+    bool invalidate;
+    std::vector<std::function<void(TransformPipeline &)>> edits;
+    {
+      std::unique_lock<std::mutex> lock(request_mutex);
+      // While scanning, only look for requests between slices
+      request_signal.wait_until(lock, scanning ? clock::now() : next_poll,
+                                [this] { return hasWork(); });
+      if (!running) {
+        return;
+      }
+      position = wanted_position;
+      force = reload_requested;
+      reload_requested = false;
+      invalidate = invalidate_requested;
+      invalidate_requested = false;
+      edits.swap(pipeline_edits);
+    }
 
-  if (new_position >= file_size) {
-    new_position = file_size - 1;
-  }
-  if (new_position < 0) {
-    new_position = 0;
-  }
+    bool changed = force || !edits.empty();
+    for (auto &edit : edits) {
+      edit(pipeline);
+    }
+
+    std::error_code ec;
+    if (invalidate) {
+      // Reopens the file and throws away pages the mtime poll would not
+      // have noticed as stale
+      auto current_write_time = std::filesystem::last_write_time(filename, ec);
+      if (!ec) {
+        last_write_time = current_write_time;
+      }
+      pipeline.invalidate();
+      ++generation;
+      changed = true;
+    } else if (clock::now() >= next_poll) {
+      next_poll = clock::now() + poll_interval;
+      auto current_write_time = std::filesystem::last_write_time(filename, ec);
+      // ec: file might be temporarily unavailable
+      if (!ec && current_write_time != last_write_time) {
+        // Cached transformed pages belong to the old contents
+        last_write_time = current_write_time;
+        pipeline.invalidate();
+        ++generation;
+        changed = true;
+      }
+    }
 
-  // TODO: first check in which chunck we are after offseting
-  auto chunk = whichChunkAreWe(new_position);
-  if (chunk != current_chunk || force) {
-    // we changed chunk
-    current_chunk = chunk;
-    loadChunk(chunk);
+    // Background work (e.g. an inflate pass) in short slices, so requests
+    // never queue behind it
+    bool was_scanning = scanning;
+    scanning = pipeline.advance();
+    if (was_scanning &&
+        (!scanning || clock::now() - last_publish >= kScanPublishInterval)) {
+      changed = true;
+    }
+
+    size_t size = std::max<size_t>(1, chunk_size);
+    size_t file_size = pipeline.size();
+    position = std::min(position, file_size > 0 ? file_size - 1 : 0);
+    size_t chunk = position / size;
+    if (changed || chunk != current_chunk || size != loaded_chunk_size) {
+      publishChunk(chunk, size);
+      last_publish = clock::now();
+      render_callback();
+    }
   }
 }
 
@@ -75,10 +174,12 @@ void Buffer::moveLeft(size_t amount) {
 }
 
 void Buffer::moveRight(size_t amount) {
+  size_t file_size = fileSize();
   if (absolute_cursor + amount < file_size) {
     absolute_cursor += amount;
   } else {
-    absolute_cursor = file_size - 1; // Prevent going beyond EOF
+    // Prevent going beyond EOF
+    absolute_cursor = file_size > 0 ? file_size - 1 : 0;
   }
 
   checkChunks(absolute_cursor);
@@ -92,27 +193,45 @@ void Buffer::goHome() {
 }
 
 void Buffer::goEnd() {
-  absolute_cursor = file_size - 1;
+  size_t file_size = fileSize();
+  absolute_cursor = file_size > 0 ? file_size - 1 : 0;
   checkChunks(absolute_cursor);
 }
 
-void Buffer::reload() { checkChunks(absolute_cursor, true); }
+// UI thread only: the loader never writes the cursor
+void Buffer::reload() {
+  {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    invalidate_requested = true;
+  }
+  checkChunks(absolute_cursor, true);
+  clampCursor();
+}
 
-void Buffer::watchFileChanges() {
-  using namespace std::chrono_literals;
+void Buffer::clampCursor() {
+  size_t file_size = fileSize();
+  if (absolute_cursor >= file_size) {
+    absolute_cursor = file_size > 0 ? file_size - 1 : 0;
+    checkChunks(absolute_cursor);
+  }
+}
 
-  while (running) {
-    std::this_thread::sleep_for(500ms); // Poll every 500ms
+void Buffer::editPipeline(std::function<void(TransformPipeline &)> edit) {
+  {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    pipeline_edits.push_back(std::move(edit));
+  }
+  request_signal.notify_one();
+}
 
-    std::error_code ec;
-    auto current_write_time = std::filesystem::last_write_time(filename, ec);
-    if (ec)
-      continue; // file might be temporarily unavailable
+void Buffer::pushTransform(std::shared_ptr<TransformStage> stage) {
+  editPipeline([stage](TransformPipeline &p) { p.push(stage); });
+}
 
-    if (current_write_time != last_write_time) {
-      last_write_time = current_write_time;
-      reload();
-      render_callback();
-    }
-  }
+void Buffer::popTransform() {
+  editPipeline([](TransformPipeline &p) { p.pop(); });
+}
+
+void Buffer::clearTransforms() {
+  editPipeline([](TransformPipeline &p) { p.clear(); });
 }
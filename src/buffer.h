@@ -4,7 +4,11 @@
 #include <vector>
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 #include <cstdint>
@@ -12,39 +16,101 @@
 #include <string>
 #include <vector>
 
-class Buffer {
-public:
+#include "transform.h"
+
+// One immutable version of the loaded window. Readers keep a reference for
+// as long as they need a consistent view (a whole frame); the loader builds
+// the next version aside and publishes it, it never touches a published one.
+struct BufferSnapshot {
   std::vector<uint8_t> data;
-  size_t absolute_cursor = 0; // Absolute cursor in file
-  size_t chunk_size = 1024;   // Default chunk size
-  size_t file_size = 0;
   size_t chunk_offset = 0; // Offset of the first loaded byte in the file
+  size_t file_size = 0;
+  std::string transforms; // Description of the active view transforms
+  bool scanning = false;  // A transform is still sizing its output
+  uint64_t generation = 0; // Bumped each time the file changes on disk
+  uint64_t version = 0;
+
+  bool contains(size_t position, size_t length = 1) const {
+    return position >= chunk_offset &&
+           position - chunk_offset + length <= data.size();
+  }
+  const uint8_t *at(size_t position) const {
+    return data.data() + (position - chunk_offset);
+  }
+};
+
+// The UI thread only moves the cursor and posts requests; a single loader
+// thread owns the transform pipeline, watches the file and publishes
+// snapshots. Nothing the UI calls waits on file I/O or a transform.
+class Buffer {
+public:
+  std::atomic<size_t> absolute_cursor{0}; // Absolute cursor in file
+  std::atomic<size_t> chunk_size{1024};   // Default chunk size
   std::string filename;
-  size_t current_chunk = 0;
-  std::function<void()> render_callback;
+  std::function<void()> render_callback; // Called from the loader thread
 
 private:
-  std::thread watcher_thread;
-  std::atomic<bool> running{true};
+  std::chrono::milliseconds poll_interval;
+
+  // Published version, only ever accessed through std::atomic_load/store
+  std::shared_ptr<const BufferSnapshot> current;
+
+  // UI -> loader requests. request_mutex is only held to post or pick them
+  // up, never while loading.
+  std::mutex request_mutex;
+  std::condition_variable request_signal;
+  bool running = true;
+  bool reload_requested = false;
+  bool invalidate_requested = false; // Re-read the file, not just republish
+  size_t wanted_position = 0;
+  std::vector<std::function<void(TransformPipeline &)>> pipeline_edits;
+
+  // Loader thread only
+  TransformPipeline pipeline;
   std::filesystem::file_time_type last_write_time;
-  std::mutex buffer_mutex;
+  size_t current_chunk = 0;
+  size_t loaded_chunk_size = 0;
+  size_t loaded_file_size = 0;
+  bool scanning = false;
+  uint64_t generation = 0;
+  uint64_t version = 0;
+
+  std::thread loader_thread;
 
 public:
   explicit Buffer(const std::string &file, std::function<void()> rcb,
-                  size_t chunk = 1024);
+                  size_t chunk = 1024,
+                  std::chrono::milliseconds poll = std::chrono::milliseconds(
+                      500));
 
   ~Buffer();
   size_t whichChunkAreWe(size_t position);
 
-  void loadChunk(size_t chunk);
+  std::shared_ptr<const BufferSnapshot> snapshot() const {
+    return std::atomic_load_explicit(&current, std::memory_order_acquire);
+  }
+  size_t fileSize() const { return snapshot()->file_size; }
+
   void checkChunks(size_t new_position, bool force = false);
   size_t getAbsoluteCursor() const;
   void moveLeft(size_t amount = 1);
   void moveRight(size_t amount = 1);
   void goHome();
   void goEnd();
+  // Manual refresh: re-reads the file and drops every transformed page
   void reload();
+  // Pulls the cursor back inside the published file size (UI thread only,
+  // e.g. after the file shrank on disk)
+  void clampCursor();
+
+  // View transforms, applied on top of each other by the loader thread
+  void pushTransform(std::shared_ptr<TransformStage> stage);
+  void popTransform();
+  void clearTransforms();
 
 private:
-  void watchFileChanges();
+  void editPipeline(std::function<void(TransformPipeline &)> edit);
+  void loaderLoop();
+  bool hasWork(); // Requires request_mutex
+  void publishChunk(size_t chunk, size_t size);
 };
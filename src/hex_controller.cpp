@@ -1,9 +1,195 @@
 #include "hex_controller.h"
 
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// "begin:end", either side may be left out; numbers accept a 0x prefix
+bool parseRegion(const std::string &token, size_t &begin, size_t &end) {
+  auto colon = token.find(':');
+  if (colon == std::string::npos) {
+    return false;
+  }
+  std::string first = token.substr(0, colon);
+  std::string last = token.substr(colon + 1);
+  begin = first.empty() ? 0 : std::stoull(first, nullptr, 0);
+  end = last.empty() ? SIZE_MAX : std::stoull(last, nullptr, 0);
+  if (end < begin) {
+    throw std::invalid_argument("empty region");
+  }
+  return true;
+}
+
+std::vector<uint8_t> parseKey(const std::string &token) {
+  std::string digits = token.rfind("0x", 0) == 0 ? token.substr(2) : token;
+  if (digits.empty() || digits.size() % 2 != 0) {
+    throw std::invalid_argument("key needs whole hex bytes");
+  }
+  std::vector<uint8_t> key;
+  for (size_t i = 0; i < digits.size(); i += 2) {
+    size_t used = 0;
+    key.push_back(std::stoul(digits.substr(i, 2), &used, 16));
+    if (used != 2) {
+      throw std::invalid_argument("bad key");
+    }
+  }
+  return key;
+}
+
+} // namespace
+
+// 🛠 ':' command line: xor <key>, swap [size], hex, base64, inflate, pop,
+// clear, plot [format]. Transforms and plot take an optional trailing
+// begin:end region.
+void HexController::executeCommand(const std::string &line) {
+  std::istringstream iss(line);
+  std::vector<std::string> args;
+  for (std::string arg; iss >> arg;) {
+    args.push_back(arg);
+  }
+  if (args.empty()) {
+    return;
+  }
+
+  try {
+    size_t begin = 0;
+    size_t end = SIZE_MAX;
+    bool has_region = args.size() > 1 && parseRegion(args.back(), begin, end);
+    if (has_region) {
+      args.pop_back();
+    }
+
+    const std::string &name = args[0];
+    if (name == "xor" && args.size() == 2) {
+      model.buffer.pushTransform(
+          std::make_shared<XorTransform>(parseKey(args[1]), begin, end));
+    } else if (name == "swap" && args.size() <= 2) {
+      size_t word =
+          args.size() == 2 ? std::stoull(args[1], nullptr, 0) : model.word_size;
+      model.buffer.pushTransform(
+          std::make_shared<ByteSwapTransform>(word, begin, end));
+    } else if (name == "hex" && args.size() == 1) {
+      model.buffer.pushTransform(
+          std::make_shared<HexDecodeTransform>(begin, end));
+    } else if ((name == "base64" || name == "b64") && args.size() == 1) {
+      model.buffer.pushTransform(
+          std::make_shared<Base64DecodeTransform>(begin, end));
+    } else if (name == "inflate" && args.size() == 1) {
+      model.buffer.pushTransform(
+          std::make_shared<InflateTransform>(begin, end));
+    } else if (name == "pop" && args.size() == 1) {
+      model.buffer.popTransform();
+    } else if (name == "clear" && args.size() == 1) {
+      model.buffer.clearTransforms();
+    } else if (name == "plot" && args.size() <= 2) {
+      SampleFormat format = model.plot_format;
+      if (args.size() == 2 && !SampleFormat::parse(args[1], format)) {
+        throw std::invalid_argument("unknown sample format");
+      }
+      // The plot reads the raw file, a region typed against transformed
+      // offsets would silently plot the wrong bytes
+      bool transformed = !model.buffer.snapshot()->transforms.empty();
+      if (has_region && transformed) {
+        throw std::invalid_argument("plot regions are raw file offsets, "
+                                    "clear the transforms first");
+      }
+      model.openPlot(format, begin, end);
+      if (transformed) {
+        model.last_command = ":" + line + " (raw file, transforms ignored)";
+        return;
+      }
+    } else {
+      model.last_command = "unknown command: " + line;
+      return;
+    }
+    model.last_command = ":" + line;
+  } catch (const std::exception &e) {
+    model.last_command = "error: " + line + " (" + e.what() + ")";
+  }
+}
+
+bool HexController::processCommandLine(ftxui::Event const &event) {
+  if (event == Event::Escape) {
+    model.command_mode = false;
+    model.command_line.clear();
+  } else if (event == Event::Return) {
+    model.command_mode = false;
+    executeCommand(model.command_line);
+    model.command_line.clear();
+  } else if (event == Event::Backspace) {
+    if (model.command_line.empty()) {
+      model.command_mode = false;
+    } else {
+      model.command_line.pop_back();
+    }
+  } else if (event.is_character()) {
+    model.command_line += event.character();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// 🛠 Plot mode: h/l pan, k/+ zoom in, j/- zoom out, p/Esc back to hex
+bool HexController::processPlotEvent(ftxui::Event const &event,
+                                     size_t amount) {
+  std::string key;
+  if (event == Event::Character('h') || event == Event::ArrowLeft) {
+    model.panPlot(false, amount);
+    key = "h";
+  } else if (event == Event::Character('l') || event == Event::ArrowRight) {
+    model.panPlot(true, amount);
+    key = "l";
+  } else if (event == Event::Character('k') || event == Event::ArrowUp ||
+             event == Event::Character('+')) {
+    model.zoomPlot(true, amount);
+    key = "+";
+  } else if (event == Event::Character('j') || event == Event::ArrowDown ||
+             event == Event::Character('-')) {
+    model.zoomPlot(false, amount);
+    key = "-";
+  } else if (event == Event::Special({27, 91, 72})) {
+    model.plot_first = 0;
+    model.last_command = "Home";
+    return true;
+  } else if (event == Event::Special({27, 91, 70})) {
+    model.plot_first = model.plot->sampleCount() - model.plot_count;
+    model.last_command = "End";
+    return true;
+  } else if (event == Event::Character('p') || event == Event::Escape) {
+    model.closePlot();
+    model.last_command = "p";
+    return true;
+  } else if (event == Event::Character('q')) {
+    model.screen.ExitLoopClosure()();
+    return true;
+  } else {
+    return false;
+  }
+  model.last_command = (amount > 1 ? std::to_string(amount) : "") + key;
+  return true;
+}
+
 bool HexController::processEvent(ftxui::Event const &event) {
   bool updated = false;
 
   if (event == Event::Custom) {
+    // Posted by the loader after publishing: the file may have shrunk or
+    // changed under an open plot
+    model.buffer.clampCursor();
+    model.refreshPlot();
+    return true;
+  }
+
+  if (model.command_mode) {
+    return processCommandLine(event);
+  }
+
+  if (event == Event::Character(':')) {
+    model.command_mode = true;
+    model.command_line.clear();
+    model.move_count = 0;
     return true;
   }
 
@@ -19,6 +205,18 @@ bool HexController::processEvent(ftxui::Event const &event) {
   size_t amount = (model.move_count > 0) ? model.move_count : 1;
   model.move_count = 0; // Reset after execution
 
+  if (model.plot) {
+    return processPlotEvent(event, amount);
+  }
+
+  if (event == Event::Character('p')) {
+    model.openPlot(model.plot_format);
+    model.last_command = model.buffer.snapshot()->transforms.empty()
+                             ? "p"
+                             : "p (raw file, transforms ignored)";
+    return true;
+  }
+
   size_t cursor = model.buffer.getAbsoluteCursor();
 
   // 🛠 model.Movement commands
@@ -6,6 +6,10 @@ class HexController {
 private:
   HexModel &model;
 
+  bool processCommandLine(ftxui::Event const &event);
+  void executeCommand(const std::string &line);
+  bool processPlotEvent(ftxui::Event const &event, size_t amount);
+
 public:
   explicit HexController(HexModel &model);
 
@@ -12,8 +12,12 @@ void HexModel::adjustViewport() {
   size_t number_of_char = columns * word_size * viewport_size;
   size_t n = (size_t)std::pow(2, std::log(number_of_char) / std::log(2));
 
-  buffer.chunk_size = n;
-  buffer.reload();
+  // Only rebuild the window when its size actually changes, not per frame.
+  // The loader republishes on its own when it sees the new chunk size.
+  if (buffer.chunk_size != n) {
+    buffer.chunk_size = n;
+    buffer.checkChunks(buffer.getAbsoluteCursor());
+  }
 
   size_t cursor_abs = buffer.getAbsoluteCursor();
   size_t cursor_row = cursor_abs / (columns * word_size);
@@ -28,6 +32,63 @@ void HexModel::adjustViewport() {
                       (viewport_size - 1) * (columns * word_size);
   }
 }
+void HexModel::openPlot(SampleFormat format, size_t begin, size_t end) {
+  plot.reset(); // Stop the previous builder first
+  plot = std::make_unique<LodPyramid>(
+      buffer.filename, format,
+      [this]() { this->screen.PostEvent(Event::Custom); }, begin, end);
+  plot_format = format;
+  plot_begin = begin;
+  plot_end = end;
+  plot_generation = buffer.snapshot()->generation;
+  plot_first = 0;
+  plot_count = plot->sampleCount();
+}
+
+void HexModel::closePlot() { plot.reset(); }
+
+// Rebuilds an open plot once the file changed on disk, keeping the view
+// where it was as far as the new sample count allows
+void HexModel::refreshPlot() {
+  if (!plot || buffer.snapshot()->generation == plot_generation) {
+    return;
+  }
+  size_t first = plot_first;
+  size_t count = plot_count;
+  openPlot(plot_format, plot_begin, plot_end);
+  size_t total = plot->sampleCount();
+  plot_count = std::min(std::max<size_t>(1, count), total);
+  plot_first = std::min(first, total - plot_count);
+}
+
+void HexModel::zoomPlot(bool in, size_t times) {
+  if (!plot) {
+    return;
+  }
+  size_t total = plot->sampleCount();
+  size_t center = plot_first + plot_count / 2;
+  for (size_t i = 0; i < times; ++i) {
+    plot_count = in ? std::max<size_t>(1, plot_count / 2)
+                    : std::min(total, plot_count * 2);
+  }
+  // Keep the center sample in place, clamped to the region
+  plot_first = center > plot_count / 2 ? center - plot_count / 2 : 0;
+  plot_first = std::min(plot_first, total - plot_count);
+}
+
+void HexModel::panPlot(bool forward, size_t steps) {
+  if (!plot) {
+    return;
+  }
+  size_t total = plot->sampleCount();
+  size_t distance = std::max<size_t>(1, plot_count / 8) * steps;
+  if (forward) {
+    plot_first = std::min(plot_first + distance, total - plot_count);
+  } else {
+    plot_first = plot_first > distance ? plot_first - distance : 0;
+  }
+}
+
 HexModel::HexModel(const std::string &filename, ScreenInteractive &screen)
     : buffer(filename, [this]() { this->screen.PostEvent(Event::Custom); }),
       screen(screen) {}
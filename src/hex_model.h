@@ -1,5 +1,6 @@
 #pragma once
 #include "buffer.h"
+#include "lod_pyramid.h"
 #include <cmath>
 #include <ftxui/component/screen_interactive.hpp>
 
@@ -16,6 +17,20 @@ struct HexModel {
   // TODO: change to a Command class
   std::string last_command = "";
 
+  // ':' command line, used to stack view transforms
+  bool command_mode = false;
+  std::string command_line = "";
+
+  // Plot mode: waveform of samples [plot_first, plot_first + plot_count)
+  // of the raw file region [plot_begin, plot_end)
+  std::unique_ptr<LodPyramid> plot;
+  SampleFormat plot_format;
+  size_t plot_first = 0;
+  size_t plot_count = 0;
+  size_t plot_begin = 0;
+  size_t plot_end = SIZE_MAX;
+  uint64_t plot_generation = 0; // Buffer generation the plot was built from
+
   // TODO: model responsibility ?
   ScreenInteractive &screen;
   Box content_box_;
@@ -23,4 +38,10 @@ struct HexModel {
   explicit HexModel(const std::string &filename, ScreenInteractive &screen);
 
   void adjustViewport();
+
+  void openPlot(SampleFormat format, size_t begin = 0, size_t end = SIZE_MAX);
+  void closePlot();
+  void refreshPlot();
+  void zoomPlot(bool in, size_t times = 1);
+  void panPlot(bool forward, size_t steps = 1);
 };
@@ -2,15 +2,18 @@
 #include "utils.h"
 
 ftxui::Element HexView::formatInspector(size_t index) {
-  // 🛠 Fix: No need to check against model.buffer.data.size()
-  if (index >= model.buffer.file_size) {
+  if (index >= snapshot->file_size) {
     return text(
         "Out of bounds"); // Only return this if the cursor is beyond EOF
   }
+  // 🛠 Only decode bytes the snapshot actually holds; the loader publishes
+  // the cursor's chunk shortly
+  if (!snapshot->contains(index)) {
+    return text("Loading...");
+  }
 
-  uint8_t u8 =
-      model.buffer
-          .data[index - model.buffer.chunk_offset]; // Adjust for chunk offset
+  const uint8_t *bytes = snapshot->at(index);
+  uint8_t u8 = bytes[0];
   int8_t i8 = static_cast<int8_t>(u8);
   uint16_t u16 = 0;
   int16_t i16 = 0;
@@ -21,28 +24,28 @@ ftxui::Element HexView::formatInspector(size_t index) {
   float f32 = 0.0f;
   double f64 = 0.0;
   char ch = static_cast<char>(u8);
-  uint16_t cu1 = 0, cu2 = 0;
-  std::memcpy(&cu1, &model.buffer.data[index - model.buffer.chunk_offset], 2);
+  uint16_t cu1 = u8, cu2 = 0;
 
-  bool is_surrogate = (cu1 >= 0xD800 && cu1 <= 0xDBFF);
-  if (is_surrogate && index + 4 <= model.buffer.file_size) {
-    std::memcpy(&cu2, &model.buffer.data[index - model.buffer.chunk_offset + 2],
-                2);
+  if (snapshot->contains(index, 2)) {
+    std::memcpy(&cu1, bytes, 2);
+    std::memcpy(&u16, bytes, 2);
+    std::memcpy(&i16, bytes, 2);
   }
 
-  if (index + 2 <= model.buffer.file_size) {
-    std::memcpy(&u16, &model.buffer.data[index - model.buffer.chunk_offset], 2);
-    std::memcpy(&i16, &model.buffer.data[index - model.buffer.chunk_offset], 2);
+  bool is_surrogate = (cu1 >= 0xD800 && cu1 <= 0xDBFF);
+  if (is_surrogate && snapshot->contains(index, 4)) {
+    std::memcpy(&cu2, bytes + 2, 2);
   }
-  if (index + 4 <= model.buffer.file_size) {
-    std::memcpy(&u32, &model.buffer.data[index - model.buffer.chunk_offset], 4);
-    std::memcpy(&i32, &model.buffer.data[index - model.buffer.chunk_offset], 4);
-    std::memcpy(&f32, &model.buffer.data[index - model.buffer.chunk_offset], 4);
+
+  if (snapshot->contains(index, 4)) {
+    std::memcpy(&u32, bytes, 4);
+    std::memcpy(&i32, bytes, 4);
+    std::memcpy(&f32, bytes, 4);
   }
-  if (index + 8 <= model.buffer.file_size) {
-    std::memcpy(&u64, &model.buffer.data[index - model.buffer.chunk_offset], 8);
-    std::memcpy(&i64, &model.buffer.data[index - model.buffer.chunk_offset], 8);
-    std::memcpy(&f64, &model.buffer.data[index - model.buffer.chunk_offset], 8);
+  if (snapshot->contains(index, 8)) {
+    std::memcpy(&u64, bytes, 8);
+    std::memcpy(&i64, bytes, 8);
+    std::memcpy(&f64, bytes, 8);
   }
 
   std::string utf8_char = utf16_to_utf8(cu1, cu2);
@@ -70,11 +73,10 @@ std::vector<Element> HexView::formatUtf8Row(size_t start, size_t length) {
   for (size_t i = 0; i < length; ++i) {
     size_t abs_pos = start + i;
 
-    if (abs_pos < model.buffer.chunk_offset ||
-        abs_pos >= model.buffer.chunk_offset + model.buffer.data.size()) {
+    if (!snapshot->contains(abs_pos)) {
       row.push_back(text(".") | color(Color::GrayDark)); // Out-of-bounds
     } else {
-      uint8_t byte = model.buffer.data[abs_pos - model.buffer.chunk_offset];
+      uint8_t byte = *snapshot->at(abs_pos);
       char display_char =
           (byte >= 32 && byte <= 126) ? byte : '.'; // Printable ASCII or dot
       auto char_element =
@@ -99,14 +101,12 @@ std::vector<Element> HexView::formatHexRow(size_t start, size_t length) {
   for (size_t i = 0; i < length; ++i) {
     size_t abs_pos = start + i;
 
-    if (abs_pos < model.buffer.chunk_offset ||
-        abs_pos >= model.buffer.chunk_offset + model.buffer.data.size()) {
+    if (!snapshot->contains(abs_pos)) {
       row.push_back(text("  ")); // 🛠 Empty space instead of ".."
     } else {
-      size_t local_pos = abs_pos - model.buffer.chunk_offset;
       std::ostringstream oss;
       oss << std::setw(2) << std::setfill('0') << std::hex
-          << (int)model.buffer.data[local_pos];
+          << (int)*snapshot->at(abs_pos);
 
       auto byte_element = text(oss.str());
 
@@ -126,6 +126,70 @@ std::vector<Element> HexView::formatHexRow(size_t start, size_t length) {
   return row;
 }
 
+void HexView::drawPlot(Canvas &canvas) {
+  LodPyramid &plot = *model.plot;
+  size_t columns = canvas.width();
+  std::vector<MinMax> bins;
+  if (!plot.query(model.plot_first, model.plot_count, columns, bins)) {
+    canvas.DrawText(0, 0,
+                    "Building pyramid... " +
+                        std::to_string((int)(plot.progress() * 100)) + "%");
+    return;
+  }
+
+  // 🛠 Autoscale on what is visible. Bins holding ±inf (float formats) can
+  // not be placed on the axis and are skipped.
+  auto drawable = [](const MinMax &bin) {
+    return bin.min <= bin.max && std::isfinite(bin.min) &&
+           std::isfinite(bin.max);
+  };
+  double low = INFINITY;
+  double high = -INFINITY;
+  for (const MinMax &bin : bins) {
+    if (drawable(bin)) {
+      low = std::min(low, bin.min);
+      high = std::max(high, bin.max);
+    }
+  }
+  if (low > high) {
+    canvas.DrawText(0, 0, "No samples");
+    return;
+  }
+
+  // Halved so the span of two extreme doubles does not overflow
+  int bottom = canvas.height() - 1;
+  double span = high / 2 - low / 2;
+  auto toY = [&](double value) {
+    if (span == 0) {
+      return bottom / 2; // Flat signal
+    }
+    return (int)std::lround((high / 2 - value / 2) / span * bottom);
+  };
+
+  // Fewer samples than columns: join the dots, otherwise each column is the
+  // vertical min/max span of the samples it covers
+  bool sparse = model.plot_count < columns;
+  int previous_x = -1;
+  int previous_y = 0;
+  for (size_t x = 0; x < columns; ++x) {
+    const MinMax &bin = bins[x];
+    if (!drawable(bin)) {
+      continue;
+    }
+    if (sparse && previous_x >= 0) {
+      canvas.DrawPointLine(previous_x, previous_y, x, toY(bin.min),
+                           Color::Cyan);
+    }
+    canvas.DrawPointLine(x, toY(bin.max), x, toY(bin.min), Color::Cyan);
+    previous_x = x;
+    previous_y = toY(bin.min);
+  }
+
+  canvas.DrawText(0, 0, std::to_string(high), Color::GrayDark);
+  canvas.DrawText(0, bottom - bottom % 4, std::to_string(low),
+                  Color::GrayDark);
+}
+
 std::vector<Element> HexView::generate_content() {
 
   std::vector<Element> rows;
@@ -146,9 +210,15 @@ std::vector<Element> HexView::generate_content() {
 }
 
 std::string HexView::generate_infobar() {
+  if (model.plot) {
+    std::ostringstream status;
+    status << model.plot->format.name() << " samples " << model.plot_first
+           << "+" << model.plot_count << " / " << model.plot->sampleCount();
+    return status.str();
+  }
 
   size_t abs_cursor = model.buffer.getAbsoluteCursor();
-  size_t file_size_display = model.buffer.file_size - 1;
+  size_t file_size_display = snapshot->file_size - 1;
 
   // 🛠 Status bar elements
   std::ostringstream status;
@@ -169,27 +239,42 @@ ftxui::Element HexView::render() {
   }
 
   model.adjustViewport();
+  snapshot = model.buffer.snapshot();
 
   std::ostringstream command_info;
+  if (model.command_mode) {
+    command_info << ":" << model.command_line << "_";
+  }
   if (model.move_count > 0) {
     command_info << model.move_count; // Display number prefix if active
   }
-  if (!model.last_command.empty()) {
+  if (!model.command_mode && !model.last_command.empty()) {
     command_info << model.last_command; // Show last executed command
   }
 
   size_t viewerwidth = model.columns * model.word_size * 2 +
                        (model.columns - 1) + 2 +
                        model.columns * model.word_size + 2;
+  const std::string &transforms = snapshot->transforms;
   return vbox(Elements{
-      // 🛠 NEW: Top Info Bar with File Name
-      window(text("File:") | bold, {text(model.buffer.filename + " ") | bold |
-                                    color(Color::Green) | flex}),
+      // 🛠 NEW: Top Info Bar with File Name and the active view transforms
+      window(text("File:") | bold,
+             hbox({text(model.buffer.filename + " ") | bold |
+                       color(Color::Green) | flex,
+                   text(transforms.empty() ? "" : " " + transforms + " ") |
+                       color(Color::Magenta),
+                   text(snapshot->scanning ? "(scanning...) " : "") |
+                       color(Color::Yellow)})),
 
       // Main UI
       hbox(Elements{
-          window(text("Data:") | bold, vbox(generate_content())) |
-              size(WIDTH, EQUAL, viewerwidth) | reflect(model.content_box_),
+          model.plot
+              ? window(text("Plot:") | bold,
+                       canvas([this](Canvas &c) { drawPlot(c); }) | flex) |
+                    flex
+              : window(text("Data:") | bold, vbox(generate_content())) |
+                    size(WIDTH, EQUAL, viewerwidth) |
+                    reflect(model.content_box_),
           separator(),
           formatInspector(model.buffer.getAbsoluteCursor()) |
               size(WIDTH, GREATER_THAN, 40) | flex,
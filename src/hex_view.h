@@ -2,16 +2,20 @@
 
 #include "hex_model.h"
 #include <cmath>
+#include <ftxui/dom/canvas.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <utf8.h>
 
 class HexView {
 private:
   HexModel &model;
+  // Buffer version this frame is drawn from, taken once per render
+  std::shared_ptr<const BufferSnapshot> snapshot;
 
   Element formatInspector(size_t index);
   std::vector<Element> formatUtf8Row(size_t start, size_t length);
   std::vector<Element> formatHexRow(size_t start, size_t length);
+  void drawPlot(Canvas &canvas);
 
 public:
   explicit HexView(HexModel &model) : model(model) {}
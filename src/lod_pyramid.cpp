@@ -0,0 +1,338 @@
+#include "lod_pyramid.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+namespace {
+
+constexpr char kCacheMagic[8] = {'H', 'X', 'L', 'O', 'D', '0', '2', '\0'};
+
+// Total size the cache directory may grow to before old entries go
+constexpr uintmax_t kCacheLimit = uintmax_t(1) << 30;
+
+constexpr MinMax kEmpty = {std::numeric_limits<double>::infinity(),
+                           -std::numeric_limits<double>::infinity()};
+
+void fold(MinMax &into, const MinMax &other) {
+  into.min = std::min(into.min, other.min);
+  into.max = std::max(into.max, other.max);
+}
+
+void fold(MinMax &into, double value) {
+  if (value == value) { // Skip NaN samples
+    into.min = std::min(into.min, value);
+    into.max = std::max(into.max, value);
+  }
+}
+
+std::filesystem::path cacheDirectory() {
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    return std::filesystem::path(xdg) / "hextui";
+  }
+  if (const char *home = std::getenv("HOME"); home && *home) {
+    return std::filesystem::path(home) / ".cache" / "hextui";
+  }
+  return {};
+}
+
+// Drops the other entries for the same plot (`keep` superseded them), then
+// the least recently used entries until the directory fits kCacheLimit
+void pruneCache(const std::filesystem::path &keep) {
+  namespace fs = std::filesystem;
+  std::string name = keep.filename().string();
+  std::string plot = name.substr(0, name.find('-') + 1);
+
+  struct Entry {
+    fs::path path;
+    uintmax_t size;
+    fs::file_time_type used;
+  };
+  std::vector<Entry> entries;
+  uintmax_t total = 0;
+  std::error_code ec;
+  for (const auto &item : fs::directory_iterator(keep.parent_path(), ec)) {
+    std::error_code item_ec;
+    const fs::path &path = item.path();
+    if (path.extension() != ".lod" || path == keep) {
+      continue;
+    }
+    if (path.filename().string().rfind(plot, 0) == 0) {
+      fs::remove(path, item_ec);
+      continue;
+    }
+    Entry entry{path, item.file_size(item_ec), item.last_write_time(item_ec)};
+    if (!item_ec) {
+      total += entry.size;
+      entries.push_back(std::move(entry));
+    }
+  }
+  total += fs::file_size(keep, ec);
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  for (const auto &entry : entries) {
+    if (total <= kCacheLimit) {
+      break;
+    }
+    if (fs::remove(entry.path, ec)) {
+      total -= entry.size;
+    }
+  }
+}
+
+} // namespace
+
+LodPyramid::LodPyramid(const std::string &file, SampleFormat format,
+                       std::function<void()> rcb, size_t begin, size_t end)
+    : format(format), filename(file), render_callback(rcb) {
+  std::error_code ec;
+  size_t file_size = std::filesystem::file_size(filename, ec);
+  if (ec) {
+    file_size = 0;
+  }
+  region_begin = std::min(begin, file_size);
+  sample_count = (std::min(end, file_size) - region_begin) / format.width();
+
+  // The cache entry is only valid for this exact file state and view. Its
+  // name starts with the plot (path, format, region) so a new entry can
+  // replace the ones left by older versions of the file.
+  auto directory = cacheDirectory();
+  auto mtime = std::filesystem::last_write_time(filename, ec);
+  if (!directory.empty() && !ec) {
+    std::hash<std::string> hash;
+    std::string plot = std::filesystem::absolute(filename).string() + "|" +
+                       format.name() + "|" + std::to_string(begin) + "|" +
+                       std::to_string(end);
+    std::string state = plot + "|" + std::to_string(file_size) + "|" +
+                        std::to_string(mtime.time_since_epoch().count()) +
+                        "|" + std::to_string(sample_count);
+    cache_path = directory / (std::to_string(hash(plot)) + "-" +
+                              std::to_string(hash(state)) + ".lod");
+  }
+
+  raw.open(filename, std::ios::binary);
+  worker = std::thread([this] { build(); });
+}
+
+LodPyramid::~LodPyramid() {
+  running = false;
+  if (worker.joinable())
+    worker.join();
+}
+
+double LodPyramid::progress() const {
+  if (is_ready || sample_count == 0) {
+    return 1.0;
+  }
+  return static_cast<double>(built_samples) / sample_count;
+}
+
+void LodPyramid::build() {
+  Levels result;
+
+  if (!loadCache(result)) {
+    size_t width = format.width();
+    size_t chunk_samples = kBaseBucket * 4096;
+    std::vector<uint8_t> bytes(chunk_samples * width);
+    std::vector<MinMax> base;
+    base.reserve((sample_count + kBaseBucket - 1) / kBaseBucket);
+
+    std::ifstream file(filename, std::ios::binary);
+    file.seekg(region_begin);
+    size_t done = 0;
+    while (done < sample_count) {
+      if (!running) {
+        return;
+      }
+      size_t wanted = std::min(chunk_samples, sample_count - done);
+      file.read(reinterpret_cast<char *>(bytes.data()), wanted * width);
+      size_t got = file.gcount() / width;
+      if (got == 0) {
+        break; // File shrank under us
+      }
+      for (size_t b = 0; b < got; b += kBaseBucket) {
+        MinMax bucket = kEmpty;
+        for (size_t i = b; i < std::min(b + kBaseBucket, got); ++i) {
+          fold(bucket, format.decode(&bytes[i * width]));
+        }
+        base.push_back(bucket);
+      }
+      done += got;
+      built_samples = done;
+      if (render_callback) {
+        render_callback(); // Progress
+      }
+    }
+
+    result.push_back(std::move(base));
+    while (result.back().size() > 1) {
+      if (!running) {
+        return;
+      }
+      const std::vector<MinMax> &below = result.back();
+      std::vector<MinMax> level((below.size() + kFanout - 1) / kFanout, kEmpty);
+      for (size_t i = 0; i < below.size(); ++i) {
+        fold(level[i / kFanout], below[i]);
+      }
+      result.push_back(std::move(level));
+    }
+    if (!running) {
+      return; // Closed while folding, nobody will read this entry soon
+    }
+    saveCache(result);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(levels_mutex);
+    levels = std::make_shared<const Levels>(std::move(result));
+  }
+  is_ready = true;
+  if (render_callback) {
+    render_callback();
+  }
+}
+
+bool LodPyramid::loadCache(Levels &result) {
+  if (cache_path.empty()) {
+    return false;
+  }
+  std::ifstream in(cache_path, std::ios::binary);
+  char magic[sizeof(kCacheMagic)];
+  uint64_t count = 0;
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kCacheMagic, sizeof(magic)) != 0 ||
+      !in.read(reinterpret_cast<char *>(&count), sizeof(count)) || count == 0) {
+    return false;
+  }
+
+  size_t expected = (sample_count + kBaseBucket - 1) / kBaseBucket;
+  result.resize(count);
+  for (auto &level : result) {
+    uint64_t size = 0;
+    if (!in.read(reinterpret_cast<char *>(&size), sizeof(size)) ||
+        size != expected) {
+      result.clear();
+      return false;
+    }
+    // Grown and read in blocks, so closing the plot does not wait for a
+    // large entry to be zeroed and read in full
+    constexpr size_t kBlock = size_t(1) << 16;
+    level.reserve(size);
+    for (size_t done = 0; done < size; done += kBlock) {
+      size_t block = std::min<size_t>(kBlock, size - done);
+      level.resize(done + block);
+      if (!running || !in.read(reinterpret_cast<char *>(level.data() + done),
+                               block * sizeof(MinMax))) {
+        result.clear();
+        return false;
+      }
+    }
+    expected = (expected + kFanout - 1) / kFanout;
+  }
+
+  // Mark the entry as recently used for pruneCache
+  std::error_code ec;
+  std::filesystem::last_write_time(
+      cache_path, std::filesystem::file_time_type::clock::now(), ec);
+  return true;
+}
+
+void LodPyramid::saveCache(const Levels &result) {
+  if (cache_path.empty()) {
+    return;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(cache_path.parent_path(), ec);
+
+  // Write aside and rename, so a concurrent reader never sees half a file
+  auto partial = cache_path;
+  partial += ".tmp";
+  {
+    std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+    uint64_t count = result.size();
+    out.write(kCacheMagic, sizeof(kCacheMagic));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (const auto &level : result) {
+      if (!running) {
+        out.setstate(std::ios::failbit); // Closed: drop the partial entry
+        break;
+      }
+      uint64_t size = level.size();
+      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+      out.write(reinterpret_cast<const char *>(level.data()),
+                size * sizeof(MinMax));
+    }
+    if (!out) {
+      out.close();
+      std::filesystem::remove(partial, ec);
+      return;
+    }
+  }
+  std::filesystem::rename(partial, cache_path, ec);
+  if (!ec && running) {
+    pruneCache(cache_path);
+  }
+}
+
+bool LodPyramid::query(size_t first, size_t count, size_t columns,
+                       std::vector<MinMax> &out) {
+  out.assign(columns, kEmpty);
+  if (columns == 0 || first >= sample_count) {
+    return true;
+  }
+  count = std::min(count, sample_count - first);
+
+  if (count / columns < kBaseBucket) {
+    readRaw(first, count, columns, out);
+    return true;
+  }
+
+  std::shared_ptr<const Levels> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(levels_mutex);
+    snapshot = levels;
+  }
+  if (!snapshot) {
+    return false;
+  }
+
+  // Coarsest level whose buckets still fit inside one column
+  size_t per_column = count / columns;
+  size_t bucket = kBaseBucket;
+  size_t depth = 0;
+  while (depth + 1 < snapshot->size() && bucket * kFanout <= per_column) {
+    bucket *= kFanout;
+    ++depth;
+  }
+
+  const std::vector<MinMax> &level = (*snapshot)[depth];
+  for (size_t c = 0; c < columns; ++c) {
+    size_t start = first + c * count / columns;
+    size_t stop = first + (c + 1) * count / columns;
+    size_t last = std::min(level.size(), (stop + bucket - 1) / bucket);
+    for (size_t b = start / bucket; b < last; ++b) {
+      fold(out[c], level[b]);
+    }
+  }
+  return true;
+}
+
+void LodPyramid::readRaw(size_t first, size_t count, size_t columns,
+                         std::vector<MinMax> &out) {
+  size_t width = format.width();
+  std::vector<uint8_t> bytes(count * width);
+  raw.clear();
+  raw.seekg(region_begin + first * width);
+  raw.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+  size_t got = raw.gcount() / width;
+
+  // Inverse of the column split in query(): the last column whose start is
+  // at or before sample i
+  for (size_t i = 0; i < got; ++i) {
+    fold(out[((i + 1) * columns - 1) / count],
+         format.decode(&bytes[i * width]));
+  }
+}
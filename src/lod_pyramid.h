@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sample_format.h"
+
+// Samples are kept as double, so 32 and 64-bit integers stay exact (up to
+// 2^53) down to single samples
+struct MinMax {
+  double min;
+  double max;
+};
+
+// Min/max decimation pyramid over the samples of a file region, so a plot
+// of billions of samples never rescans the raw data. Level 0 folds
+// kBaseBucket samples per entry, each further level folds kFanout entries of
+// the one below. It is built on a background thread and cached on disk,
+// keyed by file path, size, mtime, format and region; the cache keeps one
+// entry per plot and stays under a size cap, least recently used first.
+class LodPyramid {
+public:
+  static constexpr size_t kBaseBucket = 256;
+  static constexpr size_t kFanout = 8;
+
+  LodPyramid(const std::string &filename, SampleFormat format,
+             std::function<void()> rcb, size_t begin = 0,
+             size_t end = SIZE_MAX);
+  ~LodPyramid();
+
+  const SampleFormat format;
+
+  size_t sampleCount() const { return sample_count; }
+  bool ready() const { return is_ready; }
+  double progress() const;
+
+  // Folds samples [first, first + count) into `columns` min/max pairs; a
+  // column holding no sample comes back with min > max. Coarse views read
+  // the pyramid, fine views read the raw samples. Returns false while the
+  // needed pyramid levels are still being built.
+  bool query(size_t first, size_t count, size_t columns,
+             std::vector<MinMax> &out);
+
+private:
+  using Levels = std::vector<std::vector<MinMax>>;
+
+  std::string filename;
+  size_t region_begin = 0; // Byte offset of sample 0
+  size_t sample_count = 0;
+  std::filesystem::path cache_path;
+  std::function<void()> render_callback; // Called from the worker thread
+
+  std::shared_ptr<const Levels> levels; // Guarded by levels_mutex
+  std::mutex levels_mutex;
+  std::atomic<bool> is_ready{false};
+  std::atomic<size_t> built_samples{0};
+  std::atomic<bool> running{true};
+  std::thread worker;
+
+  std::ifstream raw; // UI thread only, for zoomed-in reads
+
+  void build();
+  bool loadCache(Levels &result);
+  void saveCache(const Levels &result);
+  void readRaw(size_t first, size_t count, size_t columns,
+               std::vector<MinMax> &out);
+};
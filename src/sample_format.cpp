@@ -0,0 +1,98 @@
+#include "sample_format.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+struct TypeInfo {
+  ScalarType type;
+  const char *name;
+  size_t width;
+};
+
+constexpr TypeInfo kTypes[] = {
+    {ScalarType::Int8, "i8", 1},     {ScalarType::UInt8, "u8", 1},
+    {ScalarType::Int16, "i16", 2},   {ScalarType::UInt16, "u16", 2},
+    {ScalarType::Int32, "i32", 4},   {ScalarType::UInt32, "u32", 4},
+    {ScalarType::Int64, "i64", 8},   {ScalarType::UInt64, "u64", 8},
+    {ScalarType::Float32, "f32", 4}, {ScalarType::Float64, "f64", 8},
+};
+
+const TypeInfo &info(ScalarType type) {
+  return *std::find_if(std::begin(kTypes), std::end(kTypes),
+                       [type](const TypeInfo &t) { return t.type == type; });
+}
+
+bool hostIsBigEndian() {
+  uint16_t probe = 1;
+  uint8_t first;
+  std::memcpy(&first, &probe, 1);
+  return first == 0;
+}
+
+template <typename T> double load(const uint8_t *bytes, bool swap) {
+  uint8_t raw[sizeof(T)];
+  std::memcpy(raw, bytes, sizeof(T));
+  if (swap) {
+    std::reverse(raw, raw + sizeof(T));
+  }
+  T value;
+  std::memcpy(&value, raw, sizeof(T));
+  return static_cast<double>(value);
+}
+
+} // namespace
+
+size_t SampleFormat::width() const { return info(type).width; }
+
+double SampleFormat::decode(const uint8_t *bytes) const {
+  bool swap = big_endian != hostIsBigEndian();
+  switch (type) {
+  case ScalarType::Int8:
+    return load<int8_t>(bytes, false);
+  case ScalarType::UInt8:
+    return load<uint8_t>(bytes, false);
+  case ScalarType::Int16:
+    return load<int16_t>(bytes, swap);
+  case ScalarType::UInt16:
+    return load<uint16_t>(bytes, swap);
+  case ScalarType::Int32:
+    return load<int32_t>(bytes, swap);
+  case ScalarType::UInt32:
+    return load<uint32_t>(bytes, swap);
+  case ScalarType::Int64:
+    return load<int64_t>(bytes, swap);
+  case ScalarType::UInt64:
+    return load<uint64_t>(bytes, swap);
+  case ScalarType::Float32:
+    return load<float>(bytes, swap);
+  case ScalarType::Float64:
+    return load<double>(bytes, swap);
+  }
+  return 0.0;
+}
+
+std::string SampleFormat::name() const {
+  std::string name = info(type).name;
+  if (width() > 1) {
+    name += big_endian ? "be" : "le";
+  }
+  return name;
+}
+
+bool SampleFormat::parse(const std::string &name, SampleFormat &format) {
+  for (const TypeInfo &t : kTypes) {
+    std::string base = t.name;
+    if (name.rfind(base, 0) != 0) {
+      continue;
+    }
+    std::string suffix = name.substr(base.size());
+    if (suffix.empty() || suffix == "le" || suffix == "be") {
+      format.type = t.type;
+      format.big_endian = suffix == "be";
+      return true;
+    }
+  }
+  return false;
+}
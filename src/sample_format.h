@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scalar sample types, the same set formatInspector decodes
+enum class ScalarType {
+  Int8,
+  UInt8,
+  Int16,
+  UInt16,
+  Int32,
+  UInt32,
+  Int64,
+  UInt64,
+  Float32,
+  Float64,
+};
+
+struct SampleFormat {
+  ScalarType type = ScalarType::Int16;
+  bool big_endian = false;
+
+  size_t width() const;
+  double decode(const uint8_t *bytes) const;
+  // Short name, e.g. "i16le", "f64be", "u8"
+  std::string name() const;
+
+  // Parses a name as produced by name(); endianness defaults to little
+  static bool parse(const std::string &name, SampleFormat &format);
+};
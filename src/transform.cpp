@@ -0,0 +1,519 @@
+#include "transform.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+// data[i] ^= key[i], 16 bytes at a time where the target has SIMD.
+void xorBytes(uint8_t *data, const uint8_t *key, size_t len) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= len; i += 16) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i),
+                     _mm_xor_si128(d, k));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= len; i += 16) {
+    vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), vld1q_u8(key + i)));
+  }
+#endif
+  for (; i < len; ++i) {
+    data[i] ^= key[i];
+  }
+}
+
+// Reverses every `word` bytes word in place; a trailing partial word is left
+// untouched. 2, 4 and 8 byte words take the SIMD path.
+void swapWords(uint8_t *data, size_t len, size_t word) {
+  size_t i = 0;
+  if (word == 2 || word == 4 || word == 8) {
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+      // Reorder the 16-bit lanes of each word, then swap bytes in each lane
+      if (word == 4) {
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+      } else if (word == 8) {
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1B), 0x1B);
+      }
+      v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= len; i += 16) {
+      uint8x16_t v = vld1q_u8(data + i);
+      v = word == 2 ? vrev16q_u8(v) : word == 4 ? vrev32q_u8(v) : vrev64q_u8(v);
+      vst1q_u8(data + i, v);
+    }
+#endif
+  }
+  for (; i + word <= len; i += word) {
+    std::reverse(data + i, data + i + word);
+  }
+}
+
+uint8_t hexNibble(uint8_t c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return 0;
+}
+
+uint8_t base64Sextet(uint8_t c) {
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+' || c == '-')
+    return 62;
+  if (c == '/' || c == '_')
+    return 63;
+  return 0;
+}
+
+} // namespace
+
+FileSource::FileSource(const std::string &file) : filename(file) {
+  invalidate();
+}
+
+size_t FileSource::size() { return file_size; }
+
+size_t FileSource::read(size_t offset, uint8_t *out, size_t len) {
+  if (!stream || offset >= file_size) {
+    stream.clear();
+    return 0;
+  }
+  stream.seekg(offset);
+  stream.read(reinterpret_cast<char *>(out), len);
+  size_t got = stream.gcount();
+  stream.clear(); // A short read at EOF must not poison the next seek
+  return got;
+}
+
+void FileSource::invalidate() {
+  // Reopen so a file replaced on disk (rename over) is picked up
+  stream.close();
+  stream.clear();
+  stream.open(filename, std::ios::binary | std::ios::ate);
+  file_size = stream ? static_cast<size_t>(stream.tellg()) : 0;
+}
+
+const std::vector<uint8_t> *PageCache::find(size_t page) {
+  auto it = index.find(page);
+  if (it == index.end()) {
+    return nullptr;
+  }
+  pages.splice(pages.begin(), pages, it->second);
+  return &it->second->second;
+}
+
+const std::vector<uint8_t> &PageCache::put(size_t page,
+                                           std::vector<uint8_t> bytes) {
+  auto it = index.find(page);
+  if (it != index.end()) {
+    pages.erase(it->second);
+    index.erase(it);
+  }
+  pages.emplace_front(page, std::move(bytes));
+  index[page] = pages.begin();
+
+  if (pages.size() > capacity) {
+    index.erase(pages.back().first);
+    pages.pop_back();
+  }
+  return pages.front().second;
+}
+
+void PageCache::erase(size_t page) {
+  auto it = index.find(page);
+  if (it != index.end()) {
+    pages.erase(it->second);
+    index.erase(it);
+  }
+}
+
+void PageCache::clear() {
+  pages.clear();
+  index.clear();
+}
+
+TransformStage::TransformStage(size_t begin, size_t end, size_t page_size)
+    : region_begin(begin), region_end(std::max(begin, end)),
+      page_size(page_size) {}
+
+size_t TransformStage::inputSize() {
+  size_t in_size = upstream->size();
+  return std::min(region_end, in_size) - std::min(region_begin, in_size);
+}
+
+size_t TransformStage::outputSize() {
+  size_t input_size = inputSize();
+  if (input_size != cached_input_size) {
+    cached_output_size = computeOutputSize(input_size);
+    cached_input_size = input_size;
+  }
+  return cached_output_size;
+}
+
+size_t TransformStage::readInput(size_t offset, uint8_t *out, size_t len) {
+  size_t input_size = inputSize();
+  if (offset >= input_size) {
+    return 0;
+  }
+  len = std::min(len, input_size - offset);
+  return upstream->read(std::min(region_begin, upstream->size()) + offset, out,
+                        len);
+}
+
+const std::vector<uint8_t> &TransformStage::page(size_t index) {
+  if (auto cached = cache.find(index)) {
+    return *cached;
+  }
+  size_t produced = outputSize();
+  size_t first = index * page_size;
+  std::vector<uint8_t> bytes(first < produced
+                                 ? std::min(page_size, produced - first)
+                                 : 0);
+  fillPage(index, bytes);
+  return cache.put(index, std::move(bytes));
+}
+
+size_t TransformStage::size() {
+  return upstream->size() - inputSize() + outputSize();
+}
+
+size_t TransformStage::read(size_t offset, uint8_t *out, size_t len) {
+  size_t in_size = upstream->size();
+  size_t begin = std::min(region_begin, in_size);
+  size_t consumed = std::min(region_end, in_size) - begin;
+  size_t produced = outputSize();
+
+  size_t copied = 0;
+  while (copied < len) {
+    size_t pos = offset + copied;
+    size_t n = 0;
+
+    if (pos < begin) {
+      // Before the region: untouched upstream bytes
+      n = upstream->read(pos, out + copied, std::min(len - copied, begin - pos));
+    } else if (pos < begin + produced) {
+      size_t local = pos - begin;
+      const std::vector<uint8_t> &bytes = page(local / page_size);
+      size_t in_page = local % page_size;
+      if (in_page < bytes.size()) {
+        n = std::min(len - copied, bytes.size() - in_page);
+        std::memcpy(out + copied, bytes.data() + in_page, n);
+      }
+    } else {
+      // After the region: upstream bytes shifted by the size change
+      n = upstream->read(pos - produced + consumed, out + copied,
+                         len - copied);
+    }
+
+    if (n == 0) {
+      break;
+    }
+    copied += n;
+  }
+  return copied;
+}
+
+void TransformStage::invalidate() { forgetPages(); }
+
+void TransformStage::forgetPages() {
+  cache.clear();
+  cached_input_size = SIZE_MAX;
+}
+
+// Same syntax as the ':' command that created the stage, so it can be
+// typed back
+std::string TransformStage::describe() const {
+  std::ostringstream oss;
+  oss << name();
+  if (region_begin != 0 || region_end != SIZE_MAX) {
+    oss << " 0x" << std::hex << region_begin << ":";
+    if (region_end != SIZE_MAX) {
+      oss << "0x" << region_end;
+    }
+  }
+  return oss.str();
+}
+
+XorTransform::XorTransform(std::vector<uint8_t> key, size_t begin, size_t end)
+    : TransformStage(begin, end, kPageSize), key(std::move(key)) {
+  if (this->key.empty()) {
+    this->key.push_back(0);
+  }
+  keystream.resize(this->key.size() + page_size);
+  for (size_t i = 0; i < keystream.size(); ++i) {
+    keystream[i] = this->key[i % this->key.size()];
+  }
+}
+
+void XorTransform::fillPage(size_t index, std::vector<uint8_t> &out) {
+  size_t first = index * page_size;
+  out.resize(readInput(first, out.data(), out.size()));
+  xorBytes(out.data(), keystream.data() + first % key.size(), out.size());
+}
+
+std::string XorTransform::name() const {
+  std::ostringstream oss;
+  oss << "xor ";
+  for (uint8_t byte : key) {
+    oss << std::setw(2) << std::setfill('0') << std::hex << (int)byte;
+  }
+  return oss.str();
+}
+
+ByteSwapTransform::ByteSwapTransform(size_t word_size, size_t begin,
+                                     size_t end)
+    : TransformStage(begin, end,
+                     std::max<size_t>(1, kPageSize / std::max<size_t>(
+                                                         1, word_size)) *
+                         std::max<size_t>(1, word_size)),
+      word_size(std::max<size_t>(1, word_size)) {}
+
+void ByteSwapTransform::fillPage(size_t index, std::vector<uint8_t> &out) {
+  out.resize(readInput(index * page_size, out.data(), out.size()));
+  swapWords(out.data(), out.size(), word_size);
+}
+
+std::string ByteSwapTransform::name() const {
+  return "swap " + std::to_string(word_size);
+}
+
+HexDecodeTransform::HexDecodeTransform(size_t begin, size_t end)
+    : TransformStage(begin, end, kPageSize) {}
+
+void HexDecodeTransform::fillPage(size_t index, std::vector<uint8_t> &out) {
+  std::vector<uint8_t> input(out.size() * 2);
+  size_t got = readInput(index * page_size * 2, input.data(), input.size());
+  out.resize(got / 2);
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i] = (hexNibble(input[2 * i]) << 4) | hexNibble(input[2 * i + 1]);
+  }
+}
+
+// Pages of 3072 output bytes map onto whole 4096 byte runs of base64 input
+Base64DecodeTransform::Base64DecodeTransform(size_t begin, size_t end)
+    : TransformStage(begin, end, kPageSize / 4 * 3) {}
+
+size_t Base64DecodeTransform::computeOutputSize(size_t input_size) {
+  size_t quads = input_size / 4;
+  if (quads == 0) {
+    return 0;
+  }
+  uint8_t tail[2] = {0, 0};
+  readInput(quads * 4 - 2, tail, 2);
+  size_t padding = (tail[1] == '=') + (tail[1] == '=' && tail[0] == '=');
+  return quads * 3 - padding;
+}
+
+void Base64DecodeTransform::fillPage(size_t index, std::vector<uint8_t> &out) {
+  std::vector<uint8_t> input(kPageSize);
+  size_t got = readInput(index * kPageSize, input.data(), input.size());
+  size_t length = out.size();
+  out.resize(got / 4 * 3);
+  for (size_t q = 0; q < got / 4; ++q) {
+    uint32_t bits = (base64Sextet(input[4 * q]) << 18) |
+                    (base64Sextet(input[4 * q + 1]) << 12) |
+                    (base64Sextet(input[4 * q + 2]) << 6) |
+                    base64Sextet(input[4 * q + 3]);
+    out[3 * q] = bits >> 16;
+    out[3 * q + 1] = bits >> 8;
+    out[3 * q + 2] = bits;
+  }
+  out.resize(std::min(length, out.size())); // Drop the '=' padding bytes
+}
+
+InflateTransform::InflateTransform(size_t begin, size_t end)
+    : TransformStage(begin, end, kPageSize) {}
+
+template <typename Sink>
+size_t InflateTransform::run(size_t first_page, Sink &&sink) {
+  z_stream zs{};
+  size_t page = 0;
+  size_t input_offset = 0;
+
+  auto checkpoint = std::upper_bound(
+      checkpoints.begin(), checkpoints.end(), first_page,
+      [](size_t p, const Checkpoint &c) { return p < c.page; });
+  if (checkpoint != checkpoints.begin()) {
+    --checkpoint;
+    if (inflateCopy(&zs, checkpoint->stream.get()) != Z_OK) {
+      return 0;
+    }
+    zs.next_in = nullptr;
+    zs.avail_in = 0;
+    page = checkpoint->page;
+    input_offset = checkpoint->input_offset;
+  } else if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+    return 0;
+  }
+
+  std::vector<uint8_t> input(64 * 1024);
+  std::vector<uint8_t> output;
+  size_t reached = page * page_size;
+  bool ended = false;
+
+  while (!ended) {
+    if (page > 0 && page % kPagesPerCheckpoint == 0 &&
+        (checkpoints.empty() || checkpoints.back().page < page)) {
+      std::shared_ptr<z_stream> snapshot(new z_stream{}, [](z_stream *s) {
+        inflateEnd(s);
+        delete s;
+      });
+      if (inflateCopy(snapshot.get(), &zs) == Z_OK) {
+        checkpoints.push_back({page, input_offset - zs.avail_in, snapshot});
+      }
+    }
+
+    output.resize(page_size);
+    zs.next_out = output.data();
+    zs.avail_out = static_cast<uInt>(page_size);
+    while (zs.avail_out > 0) {
+      if (zs.avail_in == 0) {
+        size_t got = readInput(input_offset, input.data(), input.size());
+        if (got == 0) {
+          ended = true;
+          break;
+        }
+        input_offset += got;
+        zs.next_in = input.data();
+        zs.avail_in = static_cast<uInt>(got);
+      }
+      if (inflate(&zs, Z_NO_FLUSH) != Z_OK) {
+        ended = true; // End of stream, or corrupt data: stop where we are
+        break;
+      }
+    }
+
+    output.resize(page_size - zs.avail_out);
+    reached = page * page_size + output.size();
+    if (output.empty() || !sink(page, output)) {
+      break;
+    }
+    ++page;
+  }
+
+  inflateEnd(&zs);
+  return reached;
+}
+
+size_t InflateTransform::computeOutputSize(size_t) { return known_size; }
+
+bool InflateTransform::advance() {
+  if (scanned) {
+    return false;
+  }
+
+  // Inflate from the last checkpoint up to the next one, which run() lays
+  // down on the way
+  size_t start = checkpoints.empty() ? 0 : checkpoints.back().page;
+  bool stopped = false;
+  size_t reached = run(start, [&](size_t page, std::vector<uint8_t> &) {
+    if (page >= start + kPagesPerCheckpoint) {
+      stopped = true;
+      return false;
+    }
+    return true;
+  });
+
+  // The page holding the old end was cached short
+  cache.erase(known_size / page_size);
+  known_size = std::max(known_size, reached);
+  cached_input_size = SIZE_MAX;
+  scanned = !stopped;
+  return true;
+}
+
+void InflateTransform::fillPage(size_t index, std::vector<uint8_t> &out) {
+  out.clear();
+  run(index, [&](size_t page, std::vector<uint8_t> &bytes) {
+    if (page == index) {
+      out = bytes;
+      return false;
+    }
+    cache.put(page, bytes); // Pages decoded on the way are worth keeping
+    return true;
+  });
+}
+
+void InflateTransform::invalidate() {
+  checkpoints.clear();
+  known_size = 0;
+  scanned = false;
+  TransformStage::invalidate();
+}
+
+TransformPipeline::TransformPipeline(const std::string &filename)
+    : file(std::make_shared<FileSource>(filename)) {}
+
+std::shared_ptr<ByteSource> TransformPipeline::top() const {
+  if (stages.empty()) {
+    return file;
+  }
+  return stages.back();
+}
+
+void TransformPipeline::push(std::shared_ptr<TransformStage> stage) {
+  stage->attach(top());
+  stages.push_back(std::move(stage));
+}
+
+bool TransformPipeline::pop() {
+  if (stages.empty()) {
+    return false;
+  }
+  stages.pop_back();
+  return true;
+}
+
+void TransformPipeline::invalidate() {
+  file->invalidate();
+  for (auto &stage : stages) {
+    stage->invalidate();
+  }
+}
+
+bool TransformPipeline::advance() {
+  for (size_t i = 0; i < stages.size(); ++i) {
+    if (stages[i]->advance()) {
+      // Everything stacked on top saw its input grow
+      for (size_t j = i + 1; j < stages.size(); ++j) {
+        stages[j]->forgetPages();
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string TransformPipeline::describe() const {
+  std::string description;
+  for (const auto &stage : stages) {
+    if (!description.empty()) {
+      description += " | ";
+    }
+    description += stage->describe();
+  }
+  return description;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <zlib.h>
+
+// Anything the hex view can read bytes from: the raw file or a transform
+// stacked on top of it.
+class ByteSource {
+public:
+  virtual ~ByteSource() = default;
+
+  virtual size_t size() = 0;
+  // Copies up to `len` bytes starting at `offset`, returns the amount copied.
+  virtual size_t read(size_t offset, uint8_t *out, size_t len) = 0;
+  // Drops everything derived from the underlying file (it changed on disk).
+  virtual void invalidate() = 0;
+};
+
+class FileSource : public ByteSource {
+private:
+  std::string filename;
+  std::ifstream stream;
+  size_t file_size = 0;
+
+public:
+  explicit FileSource(const std::string &file);
+
+  size_t size() override;
+  size_t read(size_t offset, uint8_t *out, size_t len) override;
+  void invalidate() override;
+};
+
+// Small LRU of transformed pages, keyed by page index.
+class PageCache {
+private:
+  using Entry = std::pair<size_t, std::vector<uint8_t>>;
+
+  size_t capacity;
+  std::list<Entry> pages; // Most recently used first
+  std::unordered_map<size_t, std::list<Entry>::iterator> index;
+
+public:
+  explicit PageCache(size_t capacity = 256) : capacity(capacity) {}
+
+  const std::vector<uint8_t> *find(size_t page);
+  const std::vector<uint8_t> &put(size_t page, std::vector<uint8_t> bytes);
+  void erase(size_t page);
+  void clear();
+};
+
+// A lazily evaluated view transform over [region_begin, region_end) of its
+// upstream source. Bytes outside the region pass through untouched; the
+// region itself is replaced by its transformed form, computed one page at a
+// time and only when the view actually reads it.
+class TransformStage : public ByteSource {
+protected:
+  std::shared_ptr<ByteSource> upstream;
+  size_t region_begin;
+  size_t region_end;
+  size_t page_size; // Output bytes per page
+  PageCache cache;
+
+  // Output size of the region, cached against the input size it was
+  // computed for
+  size_t cached_input_size = SIZE_MAX;
+  size_t cached_output_size = 0;
+
+  TransformStage(size_t begin, size_t end, size_t page_size);
+
+  // Reads region-relative input bytes from upstream.
+  size_t readInput(size_t offset, uint8_t *out, size_t len);
+  size_t inputSize();
+  size_t outputSize();
+  const std::vector<uint8_t> &page(size_t index);
+
+  virtual size_t computeOutputSize(size_t input_size) = 0;
+  // Fills `out` with output page `index`; may be short on the last page.
+  virtual void fillPage(size_t index, std::vector<uint8_t> &out) = 0;
+
+public:
+  void attach(std::shared_ptr<ByteSource> source) {
+    upstream = std::move(source);
+  }
+
+  size_t size() override;
+  size_t read(size_t offset, uint8_t *out, size_t len) override;
+  void invalidate() override;
+
+  // Runs one bounded slice of background work (e.g. finding out the output
+  // size); returns false when there was nothing left to do.
+  virtual bool advance() { return false; }
+  // Drops pages derived from an upstream that has since grown.
+  void forgetPages();
+
+  virtual std::string name() const = 0;
+  std::string describe() const;
+};
+
+class XorTransform : public TransformStage {
+private:
+  std::vector<uint8_t> key;
+  // Key repeated to cover one page from any key phase, so each page is a
+  // single contiguous buffer XOR
+  std::vector<uint8_t> keystream;
+
+protected:
+  size_t computeOutputSize(size_t input_size) override { return input_size; }
+  void fillPage(size_t index, std::vector<uint8_t> &out) override;
+
+public:
+  XorTransform(std::vector<uint8_t> key, size_t begin = 0,
+               size_t end = SIZE_MAX);
+
+  std::string name() const override;
+};
+
+// Reverses the byte order of every `word_size` bytes word (endianness swap).
+class ByteSwapTransform : public TransformStage {
+private:
+  size_t word_size;
+
+protected:
+  size_t computeOutputSize(size_t input_size) override { return input_size; }
+  void fillPage(size_t index, std::vector<uint8_t> &out) override;
+
+public:
+  explicit ByteSwapTransform(size_t word_size, size_t begin = 0,
+                             size_t end = SIZE_MAX);
+
+  std::string name() const override;
+};
+
+// Decodes contiguous hex digit pairs; invalid digits decode as 0 so offsets
+// stay seekable.
+class HexDecodeTransform : public TransformStage {
+protected:
+  size_t computeOutputSize(size_t input_size) override {
+    return input_size / 2;
+  }
+  void fillPage(size_t index, std::vector<uint8_t> &out) override;
+
+public:
+  explicit HexDecodeTransform(size_t begin = 0, size_t end = SIZE_MAX);
+
+  std::string name() const override { return "hex"; }
+};
+
+// Decodes unbroken base64 (no line breaks); invalid characters decode as 0
+// so offsets stay seekable.
+class Base64DecodeTransform : public TransformStage {
+protected:
+  size_t computeOutputSize(size_t input_size) override;
+  void fillPage(size_t index, std::vector<uint8_t> &out) override;
+
+public:
+  explicit Base64DecodeTransform(size_t begin = 0, size_t end = SIZE_MAX);
+
+  std::string name() const override { return "base64"; }
+};
+
+// Raw deflate (no zlib/gzip header). A deflate stream cannot be entered at an
+// arbitrary offset, so the inflater state is snapshotted every
+// `kPagesPerCheckpoint` pages and a page miss resumes from the closest one.
+// The output size is only known after a full pass; advance() runs that pass
+// one checkpoint at a time and size() reports what is known so far.
+class InflateTransform : public TransformStage {
+private:
+  static constexpr size_t kPagesPerCheckpoint = 256;
+
+  size_t known_size = 0;
+  bool scanned = false;
+
+  struct Checkpoint {
+    size_t page;
+    size_t input_offset;
+    std::shared_ptr<z_stream> stream;
+  };
+  std::vector<Checkpoint> checkpoints; // Sorted by page
+
+  // Inflates from the checkpoint at or before `first_page`, handing each
+  // page to `sink` until it returns false or the stream ends. Returns the
+  // output offset reached.
+  template <typename Sink> size_t run(size_t first_page, Sink &&sink);
+
+protected:
+  size_t computeOutputSize(size_t input_size) override;
+  void fillPage(size_t index, std::vector<uint8_t> &out) override;
+
+public:
+  explicit InflateTransform(size_t begin = 0, size_t end = SIZE_MAX);
+
+  void invalidate() override;
+  bool advance() override;
+  std::string name() const override { return "inflate"; }
+};
+
+// The file followed by a stack of transforms; reads go through the top one.
+class TransformPipeline {
+private:
+  std::shared_ptr<FileSource> file;
+  std::vector<std::shared_ptr<TransformStage>> stages;
+
+  std::shared_ptr<ByteSource> top() const;
+
+public:
+  explicit TransformPipeline(const std::string &filename);
+
+  size_t size() { return top()->size(); }
+  size_t read(size_t offset, uint8_t *out, size_t len) {
+    return top()->read(offset, out, len);
+  }
+
+  void push(std::shared_ptr<TransformStage> stage);
+  bool pop();
+  void clear() { stages.clear(); }
+  bool empty() const { return stages.empty(); }
+  void invalidate();
+  // Advances the lowest stage with background work by one slice; returns
+  // false once every stage is done.
+  bool advance();
+  std::string describe() const;
+};
@@ -0,0 +1,215 @@
+// ThreadSanitizer stress test for Buffer: the file is rewritten rapidly
+// while the cursor moves, then a large inflate transform is reloaded while
+// the UI side keeps moving. Every snapshot a frame could take must be
+// self-consistent, no UI call may wait on the loader, and a manual reload
+// must pick up contents the mtime poll missed.
+
+#include "buffer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+// Replaces the file atomically with `size` bytes of `fill`
+void writeVersion(const std::filesystem::path &path, uint8_t fill,
+                  size_t size) {
+  auto partial = path;
+  partial += ".tmp";
+  {
+    std::vector<char> bytes(size, static_cast<char>(fill));
+    std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  }
+  std::filesystem::rename(partial, path);
+}
+
+// What a frame does: take one snapshot and read everything from it
+void checkSnapshot(const BufferSnapshot &snapshot, uint64_t &last_version) {
+  CHECK(snapshot.version >= last_version);
+  last_version = snapshot.version;
+  CHECK(snapshot.chunk_offset + snapshot.data.size() <= snapshot.file_size);
+  for (uint8_t byte : snapshot.data) {
+    if (byte != snapshot.data[0]) {
+      CHECK(!"snapshot mixes two file versions");
+      break;
+    }
+  }
+}
+
+// The file is replaced every couple of milliseconds while the cursor,
+// chunk size and transforms change under it
+void rewriteWhileMoving(const std::filesystem::path &path) {
+  writeVersion(path, 0, 100000);
+  Buffer buffer(path.string(), [] {}, 1024, 1ms);
+  buffer.pushTransform(
+      std::make_shared<XorTransform>(std::vector<uint8_t>{0x5a}));
+
+  std::atomic<bool> stop{false};
+  std::thread writer([&] {
+    std::mt19937 random(7);
+    for (unsigned v = 1; !stop; ++v) {
+      writeVersion(path, static_cast<uint8_t>(v), 1000 + random() % 200000);
+      std::this_thread::sleep_for(2ms);
+    }
+  });
+
+  std::mt19937 random(3);
+  uint64_t last_version = 0;
+  auto until = std::chrono::steady_clock::now() + 3s;
+  while (std::chrono::steady_clock::now() < until) {
+    switch (random() % 8) {
+    case 0:
+      buffer.moveRight(random() % 5000);
+      break;
+    case 1:
+      buffer.moveLeft(random() % 5000);
+      break;
+    case 2:
+      buffer.goEnd();
+      break;
+    case 3:
+      buffer.goHome();
+      break;
+    case 4:
+      buffer.chunk_size = 256 << (random() % 4);
+      buffer.reload();
+      break;
+    case 5:
+      buffer.pushTransform(std::make_shared<ByteSwapTransform>(4));
+      buffer.popTransform();
+      break;
+    default:
+      buffer.clampCursor();
+      break;
+    }
+    checkSnapshot(*buffer.snapshot(), last_version);
+  }
+
+  stop = true;
+  writer.join();
+}
+
+// Reloading a large inflate target must not hold up cursor movement
+void inflateReloadDoesNotStall(const std::filesystem::path &path) {
+  std::vector<uint8_t> plain(64 << 20, 0x11);
+  std::vector<uint8_t> packed(compressBound(plain.size()));
+  z_stream zs{};
+  deflateInit2(&zs, 1, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  zs.next_in = plain.data();
+  zs.avail_in = plain.size();
+  zs.next_out = packed.data();
+  zs.avail_out = packed.size();
+  deflate(&zs, Z_FINISH);
+  packed.resize(zs.total_out);
+  deflateEnd(&zs);
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(packed.data()), packed.size());
+  }
+
+  Buffer buffer(path.string(), [] {}, 1024, 1ms);
+  buffer.pushTransform(std::make_shared<InflateTransform>());
+
+  auto worst = std::chrono::steady_clock::duration::zero();
+  uint64_t last_version = 0;
+  auto until = std::chrono::steady_clock::now() + 2s;
+  for (int i = 0; std::chrono::steady_clock::now() < until; ++i) {
+    if (i % 200 == 0) {
+      // Touch the file so the loader throws its pages away and starts over
+      std::filesystem::last_write_time(
+          path, std::filesystem::file_time_type::clock::now());
+    }
+    auto start = std::chrono::steady_clock::now();
+    buffer.moveRight(4096);
+    if (i % 50 == 0) {
+      buffer.goHome();
+    }
+    worst = std::max(worst, std::chrono::steady_clock::now() - start);
+    auto snapshot = buffer.snapshot();
+    if (!snapshot->transforms.empty()) { // Raw deflate bytes until then
+      checkSnapshot(*snapshot, last_version);
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+
+  auto worst_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(worst).count();
+  std::printf("worst UI call during inflate reloads: %lld ms\n",
+              static_cast<long long>(worst_ms));
+  CHECK(worst_ms < 100);
+}
+
+// A manual reload must re-read the file even when its mtime did not change
+// (e.g. rewritten within the filesystem's timestamp resolution)
+void reloadRereadsFile(const std::filesystem::path &path) {
+  writeVersion(path, 1, 4096);
+  Buffer buffer(path.string(), [] {}, 1024, 1ms);
+  buffer.pushTransform(
+      std::make_shared<XorTransform>(std::vector<uint8_t>{0xff}));
+
+  auto waitFor = [&](uint8_t expected) {
+    auto until = std::chrono::steady_clock::now() + 2s;
+    while (std::chrono::steady_clock::now() < until) {
+      auto snapshot = buffer.snapshot();
+      if (!snapshot->transforms.empty() && !snapshot->data.empty() &&
+          snapshot->data[0] == expected) {
+        return true;
+      }
+      std::this_thread::sleep_for(1ms);
+    }
+    return false;
+  };
+  CHECK(waitFor(0xfe));
+
+  // Rewrite in place and put the old mtime back, so the poll sees nothing
+  auto mtime = std::filesystem::last_write_time(path);
+  {
+    std::vector<char> bytes(4096, 2);
+    std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+    out.write(bytes.data(), bytes.size());
+  }
+  std::filesystem::last_write_time(path, mtime);
+
+  buffer.reload();
+  CHECK(waitFor(0xfd));
+}
+
+} // namespace
+
+int main() {
+  auto path = std::filesystem::temp_directory_path() /
+              ("hextui_stress_" + std::to_string(::getpid()) + ".bin");
+
+  rewriteWhileMoving(path);
+  inflateReloadDoesNotStall(path);
+  reloadRereadsFile(path);
+
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::puts("buffer stress: ok");
+  return 0;
+}